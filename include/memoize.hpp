@@ -0,0 +1,331 @@
+// ================================ MEMOIZE ================================= //
+// Project:         Type Utilities
+// Name:            memoize.hpp
+// Description:     A bounded memoizing wrapper for pure callables
+// Creator:         Vincent Reverdy
+// Contributor(s):  Vincent Reverdy [2018]
+// License:         BSD 3-Clause License
+// ========================================================================== //
+#ifndef _MEMOIZE_HPP_INCLUDED
+#define _MEMOIZE_HPP_INCLUDED
+// ========================================================================== //
+
+
+
+// ================================ PREAMBLE ================================ //
+// C++ standard library
+#include <tuple>
+#include <mutex>
+#include <chrono>
+#include <memory>
+#include <cstdint>
+#include <utility>
+#include <optional>
+#include <functional>
+#include <type_traits>
+// Project sources
+#include "type_utilities.hpp"
+// Third-party libraries
+// Miscellaneous
+namespace type_utilities {
+// ========================================================================== //
+
+
+
+/* ************************* IMPLEMENTATION DETAILS ************************* */
+// Introspects the signature of a callable: undefined for unsupported types
+template <class F, class = void>
+struct _signature
+{
+};
+
+// Introspects the signature of a callable: function types
+template <class R, class... Args>
+struct _signature<R(Args...)>
+{
+    using result = R;
+    using arguments = std::tuple<Args...>;
+};
+
+// Introspects the signature of a callable: noexcept function types
+template <class R, class... Args>
+struct _signature<R(Args...) noexcept>
+: _signature<R(Args...)>
+{
+};
+
+// Introspects the signature of a callable: function pointers
+template <class R, class... Args>
+struct _signature<R(*)(Args...)>
+: _signature<R(Args...)>
+{
+};
+
+// Introspects the signature of a callable: noexcept function pointers
+template <class R, class... Args>
+struct _signature<R(*)(Args...) noexcept>
+: _signature<R(Args...)>
+{
+};
+
+// Introspects the signature of a callable: function call operators
+template <class R, class C, class... Args>
+struct _signature<R(C::*)(Args...)>
+: _signature<R(Args...)>
+{
+};
+
+// Introspects the signature of a callable: const function call operators
+template <class R, class C, class... Args>
+struct _signature<R(C::*)(Args...) const>
+: _signature<R(Args...)>
+{
+};
+
+// Introspects the signature of a callable: noexcept function call operators
+template <class R, class C, class... Args>
+struct _signature<R(C::*)(Args...) noexcept>
+: _signature<R(Args...)>
+{
+};
+
+// Introspects the signature of a callable: const noexcept call operators
+template <class R, class C, class... Args>
+struct _signature<R(C::*)(Args...) const noexcept>
+: _signature<R(Args...)>
+{
+};
+
+// Introspects the signature of a callable: functors with a single operator
+template <class F>
+struct _signature<F, std::enable_if_t<
+    is_functor_v<F>,
+    std::void_t<decltype(&F::operator())>
+>>
+: _signature<decltype(&F::operator())>
+{
+    static_assert(
+        _min_arity<F>::value
+        == std::tuple_size_v<typename _signature<decltype(&F::operator())>
+            ::arguments>,
+        "the function call operator should not have default arguments"
+    );
+};
+
+// Checks if a type can be hashed by std::hash and compared for equality
+template <class T, class = void>
+struct _is_hashable
+: std::false_type
+{
+};
+
+// Checks if a type can be hashed by std::hash and compared for equality: true
+template <class T>
+struct _is_hashable<T, std::void_t<
+    decltype(std::size_t(std::hash<T>()(std::declval<const T&>()))),
+    decltype(bool(std::declval<const T&>() == std::declval<const T&>()))
+>>
+: std::true_type
+{
+};
+
+// A mutex that does nothing, used when thread safety is not required
+struct _null_mutex
+{
+    constexpr void lock() const noexcept {}
+    constexpr void unlock() const noexcept {}
+};
+
+// Hashes a tuple of hashable values
+template <class... Args>
+std::size_t _hash_tuple(const std::tuple<Args...>& key)
+{
+    std::uint64_t seed = 0x9e3779b97f4a7c15ULL;
+    std::apply([&seed](const auto&... args){
+        ((seed ^= std::hash<remove_cvref_t<decltype(args)>>()(args)
+            + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2)), ...);
+    }, key);
+    seed ^= seed >> 33;
+    seed *= 0xff51afd7ed558ccdULL;
+    seed ^= seed >> 33;
+    return static_cast<std::size_t>(seed);
+}
+
+// Rounds up to the next power of two
+constexpr std::size_t _ceil_power_of_two(std::size_t n)
+{
+    std::size_t result = 1;
+    while (result < n) result <<= 1;
+    return result;
+}
+/* ************************************************************************** */
+
+
+
+/* ******************************** MEMOIZE ********************************* */
+// Counters of a memoized callable
+struct memoize_statistics
+{
+    std::uint64_t hits = 0;
+    std::uint64_t misses = 0;
+    std::uint64_t evaluation_nanoseconds = 0;
+    double hit_rate() const noexcept {
+        return hits + misses ? double(hits) / double(hits + misses) : 0.;
+    }
+    double evaluation_latency() const noexcept {
+        return misses ? double(evaluation_nanoseconds) / double(misses) : 0.;
+    }
+};
+
+// A pure callable wrapped in a bounded direct-mapped cache, optionally split
+// in independently locked shards for concurrent use
+template <
+    class F,
+    bool ThreadSafe = false,
+    class Arguments = typename _signature<F>::arguments
+>
+class memoized;
+
+// A memoized callable: specialization for introspected argument types
+template <class F, bool ThreadSafe, class... Args>
+class memoized<F, ThreadSafe, std::tuple<Args...>>
+{
+    // Types
+    public:
+    using function_type = F;
+    using key_type = std::tuple<remove_cvref_t<Args>...>;
+    using result_type = remove_cvref_t<typename _signature<F>::result>;
+
+    // Assertions
+    static_assert(
+        (_is_hashable<remove_cvref_t<Args>>::value && ...),
+        "arguments must be hashable with std::hash and equality comparable"
+    );
+    static_assert(!std::is_void_v<result_type>, "result must not be void");
+    static_assert(
+        std::is_invocable_v<const F&, Args...>,
+        "the call operator must be const: mutable lambdas are not pure"
+    );
+    static_assert(
+        !std::is_invocable_v<const F&, Args...>
+        || std::is_invocable_v<const F&, const remove_cvref_t<Args>&...>,
+        "arguments must be taken by value or by const reference"
+    );
+
+    // Implementation details: types
+    private:
+    using clock = std::chrono::steady_clock;
+    using mutex_type = std::conditional_t<ThreadSafe, std::mutex, _null_mutex>;
+    struct _slot {
+        std::size_t hash = 0;
+        std::optional<std::pair<key_type, result_type>> entry;
+    };
+    struct _shard {
+        mutable mutex_type mutex;
+        std::unique_ptr<_slot[]> slots;
+        memoize_statistics statistics;
+    };
+
+    // Lifecycle
+    public:
+    explicit memoized(F f, std::size_t capacity = 1024, std::size_t shards = 1)
+    : _function(std::move(f))
+    , _shard_count(_ceil_power_of_two(ThreadSafe && shards ? shards : 1))
+    , _slot_count(_ceil_power_of_two(
+        capacity > _shard_count ? capacity / _shard_count : 1
+    ))
+    , _shards(new _shard[_shard_count]) {
+        for (std::size_t i = 0; i < _shard_count; ++i) {
+            _shards[i].slots.reset(new _slot[_slot_count]);
+        }
+    }
+
+    // Call
+    public:
+    result_type operator()(const remove_cvref_t<Args>&... args) {
+        key_type key(args...);
+        const std::size_t hash = _hash_tuple(key);
+        _shard& shard = _shards[hash & (_shard_count - 1)];
+        _slot& slot = shard.slots[(hash / _shard_count) & (_slot_count - 1)];
+        {
+            std::lock_guard<mutex_type> lock(shard.mutex);
+            if (slot.entry && slot.hash == hash && slot.entry->first == key) {
+                ++shard.statistics.hits;
+                return slot.entry->second;
+            }
+        }
+        const auto start = clock::now();
+        result_type result = std::invoke(std::as_const(_function), args...);
+        const auto time = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            clock::now() - start
+        ).count();
+        {
+            std::lock_guard<mutex_type> lock(shard.mutex);
+            ++shard.statistics.misses;
+            shard.statistics.evaluation_nanoseconds += time;
+            slot.hash = hash;
+            slot.entry.emplace(std::move(key), result);
+        }
+        return result;
+    }
+
+    // Observers
+    public:
+    std::size_t capacity() const noexcept {
+        return _shard_count * _slot_count;
+    }
+    std::size_t shards() const noexcept {
+        return _shard_count;
+    }
+    memoize_statistics statistics() const {
+        memoize_statistics result;
+        for (std::size_t i = 0; i < _shard_count; ++i) {
+            std::lock_guard<mutex_type> lock(_shards[i].mutex);
+            result.hits += _shards[i].statistics.hits;
+            result.misses += _shards[i].statistics.misses;
+            result.evaluation_nanoseconds
+                += _shards[i].statistics.evaluation_nanoseconds;
+        }
+        return result;
+    }
+
+    // Modifiers
+    public:
+    void clear() {
+        for (std::size_t i = 0; i < _shard_count; ++i) {
+            std::lock_guard<mutex_type> lock(_shards[i].mutex);
+            for (std::size_t j = 0; j < _slot_count; ++j) {
+                _shards[i].slots[j].entry.reset();
+            }
+            _shards[i].statistics = memoize_statistics();
+        }
+    }
+
+    // Implementation details: data members
+    private:
+    F _function;
+    std::size_t _shard_count;
+    std::size_t _slot_count;
+    std::unique_ptr<_shard[]> _shards;
+};
+
+// Memoizes a pure callable whose parameter types can be introspected
+template <bool ThreadSafe = false, class F>
+memoized<std::decay_t<F>, ThreadSafe> memoize(
+    F&& f,
+    std::size_t capacity = 1024,
+    std::size_t shards = ThreadSafe ? 16 : 1
+)
+{
+    return memoized<std::decay_t<F>, ThreadSafe>(
+        std::forward<F>(f), capacity, shards
+    );
+}
+/* ************************************************************************** */
+
+
+
+// ========================================================================== //
+} // namespace type_utilities
+#endif // _MEMOIZE_HPP_INCLUDED
+// ========================================================================== //
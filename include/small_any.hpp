@@ -0,0 +1,350 @@
+// =============================== SMALL ANY ================================ //
+// Project:         Type Utilities
+// Name:            small_any.hpp
+// Description:     A small-buffer type-erased value without RTTI
+// Creator:         Vincent Reverdy
+// Contributor(s):  Vincent Reverdy [2018]
+// License:         BSD 3-Clause License
+// ========================================================================== //
+#ifndef _SMALL_ANY_HPP_INCLUDED
+#define _SMALL_ANY_HPP_INCLUDED
+// ========================================================================== //
+
+
+
+// ================================ PREAMBLE ================================ //
+// C++ standard library
+#include <any>
+#include <new>
+#include <cstddef>
+#include <cstring>
+#include <utility>
+#include <type_traits>
+// Project sources
+#include "type_utilities.hpp"
+// Third-party libraries
+// Miscellaneous
+namespace type_utilities {
+// ========================================================================== //
+
+
+
+/* ************************* IMPLEMENTATION DETAILS ************************* */
+// A unique address per type, used as a type identifier without RTTI
+template <class T>
+struct _type_id
+{
+    static constexpr char value = 0;
+};
+
+// Storage strategies of a small any, from the cheapest to the most expensive
+enum class _small_any_storage {empty, trivial, inline_, heap};
+
+// Selects the storage strategy of a type
+template <class T, std::size_t Capacity, std::size_t Align>
+constexpr _small_any_storage _small_any_storage_of()
+{
+    constexpr bool fits = sizeof(T) <= Capacity && alignof(T) <= Align;
+    constexpr bool trivial = std::is_trivially_copyable_v<T>;
+    if constexpr (std::is_empty_v<T> && trivial) {
+        return _small_any_storage::empty;
+    } else if constexpr (fits && trivial) {
+        return _small_any_storage::trivial;
+    } else if constexpr (fits && std::is_nothrow_move_constructible_v<T>) {
+        return _small_any_storage::inline_;
+    } else {
+        return _small_any_storage::heap;
+    }
+}
+
+// Operations of a stored type: null operations are memcpy or no-ops
+struct _small_any_vtable
+{
+    const void* type;
+    _small_any_storage storage;
+    void (*copy)(void* destination, const void* source);
+    void (*move)(void* destination, void* source) noexcept;
+    void (*destroy)(void* object) noexcept;
+};
+
+// Operations of an object stored inline
+template <class T>
+struct _small_any_inline
+{
+    static void copy(void* destination, const void* source) {
+        ::new (destination) T(*static_cast<const T*>(source));
+    }
+    static void move(void* destination, void* source) noexcept {
+        ::new (destination) T(std::move(*static_cast<T*>(source)));
+        static_cast<T*>(source)->~T();
+    }
+    static void destroy(void* object) noexcept {
+        static_cast<T*>(object)->~T();
+    }
+};
+
+// Operations of an object stored on the heap, the buffer holding a pointer
+template <class T>
+struct _small_any_heap
+{
+    static void copy(void* destination, const void* source) {
+        const T& object = **static_cast<T* const*>(source);
+        *static_cast<T**>(destination) = new T(object);
+    }
+    static void move(void* destination, void* source) noexcept {
+        *static_cast<T**>(destination) = *static_cast<T**>(source);
+    }
+    static void destroy(void* object) noexcept {
+        delete *static_cast<T**>(object);
+    }
+};
+
+// The virtual table of a type for a given storage strategy
+template <class T, _small_any_storage Storage>
+inline constexpr _small_any_vtable _small_any_vtable_of = {
+    &_type_id<T>::value,
+    Storage,
+    Storage == _small_any_storage::inline_ ? &_small_any_inline<T>::copy
+    : Storage == _small_any_storage::heap ? &_small_any_heap<T>::copy
+    : nullptr,
+    Storage == _small_any_storage::inline_ ? &_small_any_inline<T>::move
+    : Storage == _small_any_storage::heap ? &_small_any_heap<T>::move
+    : nullptr,
+    Storage == _small_any_storage::inline_ ? &_small_any_inline<T>::destroy
+    : Storage == _small_any_storage::heap ? &_small_any_heap<T>::destroy
+    : nullptr
+};
+/* ************************************************************************** */
+
+
+
+/* ******************************* SMALL ANY ******************************** */
+// A type-erased value storing small objects inline and identifying types
+// without RTTI: empty trivially copyable types use no storage, trivially
+// copyable types are copied with memcpy, small nothrow-movable types are
+// stored inline, and other types are allocated on the heap
+template <
+    std::size_t Capacity = 3 * sizeof(void*),
+    std::size_t Align = alignof(std::max_align_t)
+>
+class small_any
+{
+    // Assertions
+    static_assert(Capacity >= sizeof(void*), "capacity must fit a pointer");
+    static_assert(Align >= alignof(void*), "alignment must fit a pointer");
+
+    // Friends
+    template <class T, std::size_t C, std::size_t A>
+    friend const T* small_any_cast(const small_any<C, A>* operand) noexcept;
+
+    // Lifecycle
+    public:
+    constexpr small_any() noexcept = default;
+    small_any(const small_any& other)
+    : _vtable(other._vtable) {
+        _copy_from(other);
+    }
+    small_any(small_any&& other) noexcept
+    : _vtable(other._vtable) {
+        _move_from(other);
+    }
+    template <
+        class T,
+        class = std::enable_if_t<!std::is_same_v<remove_cvref_t<T>, small_any>>
+    >
+    small_any(T&& value) {
+        _construct<remove_cvref_t<T>>(std::forward<T>(value));
+    }
+    ~small_any() {
+        reset();
+    }
+
+    // Assignment
+    public:
+    small_any& operator=(const small_any& other) {
+        if (this != &other) {
+            small_any copy(other);
+            *this = std::move(copy);
+        }
+        return *this;
+    }
+    small_any& operator=(small_any&& other) noexcept {
+        if (this != &other) {
+            reset();
+            _vtable = other._vtable;
+            _move_from(other);
+        }
+        return *this;
+    }
+    template <
+        class T,
+        class = std::enable_if_t<!std::is_same_v<remove_cvref_t<T>, small_any>>
+    >
+    small_any& operator=(T&& value) {
+        small_any(std::forward<T>(value)).swap(*this);
+        return *this;
+    }
+
+    // Modifiers
+    public:
+    template <class T, class... Args>
+    T& emplace(Args&&... args) {
+        small_any value;
+        value._construct<T>(std::forward<Args>(args)...);
+        *this = std::move(value);
+        return _object<T>();
+    }
+    void reset() noexcept {
+        if (_vtable && _vtable->destroy) {
+            _vtable->destroy(_buffer);
+        }
+        _vtable = nullptr;
+    }
+    void swap(small_any& other) noexcept {
+        small_any tmp(std::move(other));
+        other = std::move(*this);
+        *this = std::move(tmp);
+    }
+
+    // Observers
+    public:
+    bool has_value() const noexcept {
+        return _vtable != nullptr;
+    }
+    const void* type_id() const noexcept {
+        return _vtable ? _vtable->type : nullptr;
+    }
+    template <class T>
+    bool holds() const noexcept {
+        return type_id() == &_type_id<T>::value;
+    }
+
+    // Implementation details: construction into an empty small any
+    private:
+    template <class T, class... Args>
+    void _construct(Args&&... args) {
+        static_assert(std::is_same_v<T, remove_cvref_t<T>>, "decayed type");
+        static_assert(std::is_copy_constructible_v<T>, "copyable type");
+        constexpr _small_any_storage storage
+            = _small_any_storage_of<T, Capacity, Align>();
+        if constexpr (storage == _small_any_storage::heap) {
+            T* object = new T(std::forward<Args>(args)...);
+            ::new (static_cast<void*>(_buffer)) T*(object);
+        } else {
+            ::new (static_cast<void*>(_buffer)) T(std::forward<Args>(args)...);
+        }
+        _vtable = &_small_any_vtable_of<T, storage>;
+    }
+    template <class T>
+    T& _object() noexcept {
+        constexpr _small_any_storage storage
+            = _small_any_storage_of<T, Capacity, Align>();
+        if constexpr (storage == _small_any_storage::heap) {
+            return **std::launder(reinterpret_cast<T**>(_buffer));
+        } else {
+            return *std::launder(reinterpret_cast<T*>(_buffer));
+        }
+    }
+
+    // Implementation details: the vtable is already set to the one of other
+    private:
+    void _copy_from(const small_any& other) {
+        if (!_vtable || _vtable->storage == _small_any_storage::empty) {
+        } else if (_vtable->storage == _small_any_storage::trivial) {
+            std::memcpy(_buffer, other._buffer, Capacity);
+        } else {
+            try {
+                _vtable->copy(_buffer, other._buffer);
+            } catch (...) {
+                _vtable = nullptr;
+                throw;
+            }
+        }
+    }
+    void _move_from(small_any& other) noexcept {
+        if (!_vtable || _vtable->storage == _small_any_storage::empty) {
+        } else if (_vtable->storage == _small_any_storage::trivial) {
+            std::memcpy(_buffer, other._buffer, Capacity);
+        } else {
+            _vtable->move(_buffer, other._buffer);
+        }
+        other._vtable = nullptr;
+    }
+
+    // Implementation details: data members
+    private:
+    const _small_any_vtable* _vtable = nullptr;
+    alignas(Align) unsigned char _buffer[Capacity] = {};
+};
+
+// Swaps two small any
+template <std::size_t Capacity, std::size_t Align>
+void swap(small_any<Capacity, Align>& x, small_any<Capacity, Align>& y) noexcept
+{
+    x.swap(y);
+}
+
+// Accesses the contained value, or returns a null pointer: const version
+template <class T, std::size_t Capacity, std::size_t Align>
+const T* small_any_cast(const small_any<Capacity, Align>* operand) noexcept
+{
+    using type = std::remove_cv_t<T>;
+    constexpr bool heap = _small_any_storage_of<type, Capacity, Align>()
+        == _small_any_storage::heap;
+    const T* result = nullptr;
+    if (operand && operand->template holds<type>()) {
+        if constexpr (heap) {
+            result = *std::launder(
+                reinterpret_cast<type* const*>(operand->_buffer)
+            );
+        } else {
+            result = std::launder(
+                reinterpret_cast<const type*>(operand->_buffer)
+            );
+        }
+    }
+    return result;
+}
+
+// Accesses the contained value, or returns a null pointer: non-const version
+template <class T, std::size_t Capacity, std::size_t Align>
+T* small_any_cast(small_any<Capacity, Align>* operand) noexcept
+{
+    const small_any<Capacity, Align>* constant = operand;
+    return const_cast<T*>(small_any_cast<T>(constant));
+}
+
+// Accesses the contained value, or throws std::bad_any_cast: const version
+template <class T, std::size_t Capacity, std::size_t Align>
+T small_any_cast(const small_any<Capacity, Align>& operand)
+{
+    const auto* result = small_any_cast<remove_cvref_t<T>>(&operand);
+    if (!result) throw std::bad_any_cast();
+    return static_cast<T>(*result);
+}
+
+// Accesses the contained value, or throws std::bad_any_cast: lvalue version
+template <class T, std::size_t Capacity, std::size_t Align>
+T small_any_cast(small_any<Capacity, Align>& operand)
+{
+    auto* result = small_any_cast<remove_cvref_t<T>>(&operand);
+    if (!result) throw std::bad_any_cast();
+    return static_cast<T>(*result);
+}
+
+// Accesses the contained value, or throws std::bad_any_cast: rvalue version
+template <class T, std::size_t Capacity, std::size_t Align>
+T small_any_cast(small_any<Capacity, Align>&& operand)
+{
+    auto* result = small_any_cast<remove_cvref_t<T>>(&operand);
+    if (!result) throw std::bad_any_cast();
+    return static_cast<T>(std::move(*result));
+}
+/* ************************************************************************** */
+
+
+
+// ========================================================================== //
+} // namespace type_utilities
+#endif // _SMALL_ANY_HPP_INCLUDED
+// ========================================================================== //
@@ -14,6 +14,7 @@
 
 // ================================ PREAMBLE ================================ //
 // C++ standard library
+#include <tuple>
 #include <type_traits>
 // Project sources
 // Third-party libraries
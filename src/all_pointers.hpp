@@ -0,0 +1,629 @@
+// ============================== ALL POINTERS ============================== //
+// Project:         Type Utilities
+// Name:            all_pointers.hpp
+// Description:     Nested-pointer tensors built with remove_all_pointers
+// Creator:         Vincent Reverdy
+// Contributor(s):  Vincent Reverdy [2018]
+// License:         BSD 3-Clause License
+// ========================================================================== //
+#ifndef _ALL_POINTERS_HPP_INCLUDED
+#define _ALL_POINTERS_HPP_INCLUDED
+// ========================================================================== //
+
+
+
+// ================================ PREAMBLE ================================ //
+// C++ standard library
+#include <array>
+#include <tuple>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <utility>
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
+#include <system_error>
+// Project sources
+#include "../include/type_utilities.hpp"
+// Third-party libraries
+// Miscellaneous
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+namespace type_utilities {
+// ========================================================================== //
+
+
+
+/* ****************************** ALL POINTERS ****************************** */
+// Enables if the type is a pointer to a tensor element
+template <class T> using enable_if_element_pointer_t = std::enable_if_t<
+    std::is_pointer_v<T> && !std::is_pointer_v<std::remove_pointer_t<T>>
+>;
+
+// Counts the number of indices needed to reach a tensor element
+template <class T, class = void>
+struct tensor_rank
+: index_constant<0>
+{
+};
+
+// Counts the number of indices needed to reach a tensor element: recursion
+template <class T>
+struct tensor_rank<T, std::enable_if_t<
+    std::is_pointer_v<T> && std::is_pointer_v<std::remove_pointer_t<T>>
+>>
+: index_constant<1 + tensor_rank<std::remove_pointer_t<T>>::value>
+{
+};
+
+// Variable template and index tuple alias template
+template <class T>
+inline constexpr std::size_t tensor_rank_v = tensor_rank<T>::value;
+template <class T>
+using tensor_index_t = std::array<std::size_t, tensor_rank_v<T>>;
+
+// Gets an element: tail
+template <class T, class = enable_if_element_pointer_t<T>>
+constexpr remove_all_pointers_t<T> get_element(T& tensor) {
+    return tensor ? *tensor : remove_all_pointers_t<T>();
+}
+
+// Gets an element: recursive call
+template <class T, class... Indices>
+constexpr remove_all_pointers_t<T> get_element(
+    T& tensor, std::size_t idx, Indices&&... idxs
+) {
+    return tensor && tensor[idx]
+        ? get_element(tensor[idx], std::forward<Indices>(idxs)...)
+        : remove_all_pointers_t<T>();
+}
+
+// A pointer walker descending one level per application of operator->*
+template <class T>
+struct _walker
+{
+    T pointer;
+};
+
+// Descends one level of a tensor, propagating null pointers
+template <class T, class Index>
+constexpr _walker<std::remove_pointer_t<T>> operator->*(
+    _walker<T> walker, Index idx
+) {
+    return {walker.pointer ? walker.pointer[idx] : nullptr};
+}
+
+// Gets an element at compile-time indices with an unrolled descent
+template <class T, std::size_t... I>
+constexpr remove_all_pointers_t<T> get_element(
+    T& tensor, index_constant<I>... idxs
+) {
+    static_assert(sizeof...(I) == tensor_rank_v<T>, "one index per level");
+    const auto element = (_walker<T>{tensor} ->* ... ->* idxs).pointer;
+    return element ? *element : remove_all_pointers_t<T>();
+}
+
+// Gets an element at compile-time indices with an unrolled descent: shorthand
+template <std::size_t I0, std::size_t... I, class T>
+constexpr remove_all_pointers_t<T> get_element(T& tensor) {
+    return get_element(tensor, index_constant<I0>(), index_constant<I>()...);
+}
+
+// Sets an element: tail
+template <std::size_t N, class T, class = enable_if_element_pointer_t<T>>
+void set_element(const remove_all_pointers_t<T>& val, T& tensor) {
+    using raw_t = remove_all_pointers_t<T>;
+    tensor ? (*tensor = val, 0) : (tensor = new raw_t(val), 0);
+}
+
+// Sets an element: recursive call
+template <std::size_t N, class T, class... I>
+void set_element(
+    const remove_all_pointers_t<T>& val, T& tensor, std::size_t idx, I&&... idxs
+) {
+    if (!tensor) {
+        tensor = new std::remove_pointer_t<T>[N];
+        for (std::size_t i = 0; i < N; ++i) tensor[i] = nullptr;
+    }
+    set_element<N>(val, tensor[idx], std::forward<I>(idxs)...);
+}
+
+// Removes a given number of pointers from a type
+template <class T, std::size_t N>
+struct _remove_pointers
+{
+    using type = typename _remove_pointers<
+        std::remove_pointer_t<T>, N - 1
+    >::type;
+};
+
+// Removes a given number of pointers from a type: no pointer to remove
+template <class T>
+struct _remove_pointers<T, 0>
+{
+    using type = T;
+};
+
+// The pointers on the path from the root of a tensor to one of its elements
+template <class T, class = std::make_index_sequence<tensor_rank_v<T> + 1>>
+struct _tensor_path;
+
+// The pointers on the path to an element: one pointer per level
+template <class T, std::size_t... L>
+struct _tensor_path<T, std::index_sequence<L...>>
+{
+    using type = std::tuple<typename _remove_pointers<T, L>::type...>;
+};
+
+// Alias template
+template <class T>
+using _tensor_path_t = typename _tensor_path<T>::type;
+
+// Loads the pointer of a given level on the path of the element entering this
+// stage of the gathering pipeline, and prefetches what the next stage reads
+template <
+    std::size_t L, std::size_t Distance,
+    class Path, std::size_t Ring, class Index
+>
+void _gather_stage(
+    Path (&paths)[Ring], const Index* indices, std::size_t size, std::size_t t
+) {
+    if (t >= L * Distance && t - L * Distance < size) {
+        const std::size_t k = t - L * Distance;
+        Path& path = paths[k % Ring];
+        const auto node = std::get<L>(path);
+        const auto next = node ? node[indices[k][L]] : nullptr;
+        std::get<L + 1>(path) = next;
+        if constexpr (L + 2 < std::tuple_size_v<Path>) {
+            if (next) __builtin_prefetch(next + indices[k][L + 1]);
+        } else {
+            __builtin_prefetch(next);
+        }
+    }
+}
+
+// Gathers a range of elements, software-pipelining the pointer walk with one
+// stage per level: at step t, the level L pointer of element t - L * Distance
+// is loaded and prefetched while element t - rank * Distance is read
+template <
+    std::size_t Distance, class T, class Index, class Value, std::size_t... L
+>
+void _gather_elements(
+    T tensor, const Index* indices, Value* values, std::size_t size,
+    std::index_sequence<L...>
+) {
+    using raw_t = remove_all_pointers_t<T>;
+    constexpr std::size_t rank = sizeof...(L);
+    constexpr std::size_t latency = rank * Distance;
+    constexpr std::size_t ring = latency + Distance;
+    _tensor_path_t<T> paths[ring] = {};
+    for (auto& path: paths) std::get<0>(path) = tensor;
+    for (std::size_t t = 0; t < size + latency; ++t) {
+        if (t >= latency) {
+            const auto element = std::get<rank>(paths[(t - latency) % ring]);
+            values[t - latency] = element ? *element : raw_t();
+        }
+        (_gather_stage<L, Distance>(paths, indices, size, t), ...);
+    }
+}
+
+// Gathers a range of elements, prefetching each level of the pointer walk
+// Distance elements ahead of the next level
+template <std::size_t Distance = 8, class T, class Indices, class Values>
+void gather_elements(T& tensor, const Indices& indices, Values& values) {
+    static_assert(Distance > 0, "the prefetch distance should be positive");
+    _gather_elements<Distance>(
+        tensor, std::data(indices), std::data(values), std::size(indices),
+        std::make_index_sequence<tensor_rank_v<T>>()
+    );
+}
+
+// Deallocates the entire tensor
+template <std::size_t N, class T>
+void deallocate(T& tensor) {
+    if constexpr (!std::is_pointer_v<std::remove_pointer_t<T>>) {
+        delete tensor;
+        tensor = nullptr;
+    } else if constexpr (std::is_pointer_v<std::remove_pointer_t<T>>) {
+        if (tensor) {
+            for (std::size_t i = 0; i < N; ++i) deallocate<N>(tensor[i]);
+            delete[] tensor;
+            tensor = nullptr;
+        }
+    }
+}
+
+// A cursor scanning a tensor in row-major order, caching the pointers on the
+// path to the current element so that only the levels whose index changed
+// are walked again
+template <std::size_t N, class T>
+class tensor_cursor
+{
+    // Types
+    public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = remove_all_pointers_t<T>;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const value_type*;
+    using reference = value_type;
+    using index_type = tensor_index_t<T>;
+
+    // Constants
+    public:
+    static constexpr std::size_t rank = tensor_rank_v<T>;
+    static constexpr std::size_t size = [](std::size_t n = 1) {
+        for (std::size_t l = 0; l < rank; ++l) n *= N;
+        return n;
+    }();
+    static_assert(rank > 0, "the tensor should have at least one index");
+
+    // Implementation details: types
+    private:
+    using path_type = _tensor_path_t<T>;
+
+    // Lifecycle
+    public:
+    explicit tensor_cursor(T tensor, std::size_t position = 0)
+    : _position(position) {
+        std::get<0>(_path) = tensor;
+        _locate(0);
+    }
+
+    // Access
+    public:
+    reference operator*() const {
+        const auto element = std::get<rank>(_path);
+        return element ? *element : value_type();
+    }
+    pointer operator->() const {
+        static const value_type missing = value_type();
+        const auto element = std::get<rank>(_path);
+        return element ? element : &missing;
+    }
+    const index_type& index() const noexcept {
+        return _index;
+    }
+    std::size_t position() const noexcept {
+        return _position;
+    }
+
+    // Movement
+    public:
+    tensor_cursor& operator++() {
+        std::size_t level = rank - 1;
+        while (++_index[level] == N && level > 0) _index[level--] = 0;
+        if (++_position < size) _descend(level);
+        return *this;
+    }
+    tensor_cursor operator++(int) {
+        tensor_cursor result = *this;
+        ++*this;
+        return result;
+    }
+    tensor_cursor& advance(difference_type n) {
+        _position += n;
+        return _locate(rank);
+    }
+
+    // Comparison
+    public:
+    friend bool operator==(const tensor_cursor& x, const tensor_cursor& y) {
+        return x._position == y._position;
+    }
+    friend bool operator!=(const tensor_cursor& x, const tensor_cursor& y) {
+        return x._position != y._position;
+    }
+
+    // Implementation details: path update
+    private:
+    tensor_cursor& _locate(std::size_t level) {
+        std::size_t position = _position;
+        for (std::size_t l = rank; l-- > 0; position /= N) {
+            const std::size_t idx = l > 0 ? position % N : position;
+            level = idx != _index[l] ? l : level;
+            _index[l] = idx;
+        }
+        if (_position < size) _descend(level);
+        return *this;
+    }
+    void _descend(std::size_t level) {
+        _descend(level, std::make_index_sequence<rank>());
+    }
+    template <std::size_t... L>
+    void _descend(std::size_t level, std::index_sequence<L...>) {
+        ((L >= level ? void(std::get<L + 1>(_path) = std::get<L>(_path)
+            ? std::get<L>(_path)[_index[L]]
+            : nullptr
+        ) : void()), ...);
+    }
+
+    // Implementation details: data members
+    private:
+    std::size_t _position;
+    index_type _index = {};
+    path_type _path = {};
+};
+
+// Makes cursors to the first element and past the last element of a tensor
+template <std::size_t N, class T>
+std::pair<tensor_cursor<N, T>, tensor_cursor<N, T>> make_cursors(T tensor) {
+    return {
+        tensor_cursor<N, T>(tensor),
+        tensor_cursor<N, T>(tensor, tensor_cursor<N, T>::size)
+    };
+}
+
+// The header of a flat tensor file, followed by a table of interior nodes of
+// N offsets each, and by the leaf data: offsets are in bytes from the start of
+// the file, and zero stands for a null pointer
+struct tensor_file_header
+{
+    static constexpr char signature[8] = {
+        'T', 'E', 'N', 'S', 'O', 'R', '0', '1'
+    };
+    char magic[8];
+    std::uint64_t rank;
+    std::uint64_t dimension;
+    std::uint64_t element_size;
+    std::uint64_t nodes;
+    std::uint64_t leaves;
+    std::uint64_t leaf_offset;
+    std::uint64_t root;
+};
+
+// Counts the interior nodes and the leaves of a tensor
+template <std::size_t N, class T>
+void _count_nodes(
+    const T& tensor, std::uint64_t& nodes, std::uint64_t& leaves
+) {
+    if constexpr (!std::is_pointer_v<std::remove_pointer_t<T>>) {
+        leaves += tensor != nullptr;
+    } else if (tensor) {
+        ++nodes;
+        for (std::size_t i = 0; i < N; ++i) {
+            _count_nodes<N>(tensor[i], nodes, leaves);
+        }
+    }
+}
+
+// Flattens a tensor, returning the offset of its root
+template <std::size_t N, class T, class Value>
+std::uint64_t _flatten(
+    const T& tensor, const tensor_file_header& header,
+    std::vector<std::uint64_t>& table, std::vector<Value>& leaves
+) {
+    std::uint64_t offset = 0;
+    if constexpr (!std::is_pointer_v<std::remove_pointer_t<T>>) {
+        if (tensor) {
+            offset = header.leaf_offset + leaves.size() * sizeof(Value);
+            leaves.push_back(*tensor);
+        }
+    } else if (tensor) {
+        const std::size_t node = table.size();
+        offset = sizeof(header) + node * sizeof(std::uint64_t);
+        table.resize(node + N);
+        for (std::size_t i = 0; i < N; ++i) {
+            const std::uint64_t child = _flatten<N>(
+                tensor[i], header, table, leaves
+            );
+            table[node + i] = child;
+        }
+    }
+    return offset;
+}
+
+// Writes a whole buffer to a file descriptor, resuming after partial writes
+inline bool _write_file(int file, const void* data, std::size_t size) {
+    const char* bytes = static_cast<const char*>(data);
+    while (size > 0) {
+        const ssize_t count = ::write(file, bytes, size);
+        if (count < 0 && errno == EINTR) continue;
+        if (count <= 0) {
+            errno = count == 0 ? EIO : errno;
+            return false;
+        }
+        bytes += count;
+        size -= count;
+    }
+    return true;
+}
+
+// Saves a tensor to a flat file that can be memory-mapped by mapped_tensor: the
+// file is written to a unique temporary file next to the destination, synced,
+// and renamed over the destination, whose directory is then synced
+template <std::size_t N, class T>
+void save_tensor(const T& tensor, const std::string& path) {
+    using raw_t = remove_all_pointers_t<T>;
+    static_assert(std::is_trivially_copyable_v<raw_t>, "flat element type");
+    static_assert(tensor_rank_v<T> > 0, "the tensor should have an index");
+    tensor_file_header header = {};
+    std::vector<std::uint64_t> table;
+    std::vector<raw_t> leaves;
+    std::memcpy(header.magic, header.signature, sizeof(header.magic));
+    header.rank = tensor_rank_v<T>;
+    header.dimension = N;
+    header.element_size = sizeof(raw_t);
+    _count_nodes<N>(tensor, header.nodes, header.leaves);
+    header.leaf_offset = sizeof(header);
+    header.leaf_offset += header.nodes * N * sizeof(std::uint64_t);
+    header.leaf_offset += (alignof(raw_t) - header.leaf_offset % alignof(raw_t))
+        % alignof(raw_t);
+    table.reserve(header.nodes * N);
+    leaves.reserve(header.leaves);
+    header.root = _flatten<N>(tensor, header, table, leaves);
+    const std::vector<char> padding(
+        header.leaf_offset - sizeof(header)
+        - table.size() * sizeof(std::uint64_t)
+    );
+    const std::size_t slash = path.rfind('/');
+    const std::string directory
+        = slash == std::string::npos ? "." : path.substr(0, slash + 1);
+    std::string temporary = path + ".XXXXXX";
+    const int file = ::mkstemp(temporary.data());
+    if (file < 0) {
+        throw std::system_error(errno, std::generic_category(), path);
+    }
+    const bool written = ::fchmod(file, 0644) == 0
+        && _write_file(file, &header, sizeof(header))
+        && _write_file(file, table.data(), table.size() * sizeof(table[0]))
+        && _write_file(file, padding.data(), padding.size())
+        && _write_file(file, leaves.data(), leaves.size() * sizeof(raw_t))
+        && ::fsync(file) == 0;
+    int error = written ? 0 : errno;
+    if (::close(file) != 0 && error == 0) {
+        error = errno;
+    }
+    if (error == 0 && ::rename(temporary.c_str(), path.c_str()) != 0) {
+        error = errno;
+    }
+    if (error != 0) {
+        ::unlink(temporary.c_str());
+        throw std::system_error(error, std::generic_category(), path);
+    }
+    const int parent = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+    if (parent < 0 || ::fsync(parent) != 0) {
+        error = errno;
+        if (parent >= 0) ::close(parent);
+        throw std::system_error(error, std::generic_category(), directory);
+    }
+    ::close(parent);
+}
+
+// A read-only view of a tensor file mapped in memory: elements are accessed in
+// place, and pages are loaded lazily on first access; the header is checked
+// when mapping, and every offset and index is checked when it is followed
+template <class T>
+class mapped_tensor
+{
+    // Types
+    public:
+    using value_type = remove_all_pointers_t<T>;
+    static constexpr std::size_t rank = tensor_rank_v<T>;
+
+    // Lifecycle
+    public:
+    explicit mapped_tensor(const std::string& path) {
+        const int file = ::open(path.c_str(), O_RDONLY);
+        struct stat status = {};
+        if (file < 0 || ::fstat(file, &status) != 0) {
+            const int error = errno;
+            if (file >= 0) ::close(file);
+            throw std::system_error(error, std::generic_category(), path);
+        }
+        if (status.st_size < off_t(sizeof(tensor_file_header))) {
+            ::close(file);
+            throw std::runtime_error("invalid tensor file " + path);
+        }
+        _size = status.st_size;
+        _data = ::mmap(nullptr, _size, PROT_READ, MAP_SHARED, file, 0);
+        const int error = errno;
+        ::close(file);
+        if (_data == MAP_FAILED) {
+            _data = nullptr;
+            throw std::system_error(error, std::generic_category(), path);
+        }
+        if (!_valid()) {
+            ::munmap(_data, _size);
+            _data = nullptr;
+            throw std::runtime_error("invalid tensor file " + path);
+        }
+    }
+    mapped_tensor(mapped_tensor&& other) noexcept
+    : _data(std::exchange(other._data, nullptr))
+    , _size(std::exchange(other._size, 0)) {
+    }
+    mapped_tensor& operator=(mapped_tensor&& other) noexcept {
+        std::swap(_data, other._data);
+        std::swap(_size, other._size);
+        return *this;
+    }
+    ~mapped_tensor() {
+        if (_data) ::munmap(_data, _size);
+    }
+
+    // Access
+    public:
+    template <class... Indices>
+    value_type get_element(Indices... idxs) const {
+        static_assert(sizeof...(Indices) == rank, "one index per level");
+        std::uint64_t offset = header().root;
+        ((offset = _child(offset, idxs)), ...);
+        if (offset && !_is_leaf(offset)) {
+            throw std::runtime_error("invalid tensor file offset");
+        }
+        value_type result = value_type();
+        if (offset) std::memcpy(&result, _bytes() + offset, sizeof(result));
+        return result;
+    }
+    const tensor_file_header& header() const noexcept {
+        return *static_cast<const tensor_file_header*>(_data);
+    }
+
+    // Implementation details
+    private:
+    const unsigned char* _bytes() const noexcept {
+        return static_cast<const unsigned char*>(_data);
+    }
+    template <class Index>
+    std::uint64_t _child(std::uint64_t offset, Index idx) const {
+        if (offset && !_is_node(offset)) {
+            throw std::runtime_error("invalid tensor file offset");
+        }
+        if (static_cast<std::uint64_t>(idx) >= header().dimension) {
+            throw std::out_of_range("tensor index out of range");
+        }
+        return offset ? _node(offset)[idx] : 0;
+    }
+    const std::uint64_t* _node(std::uint64_t offset) const noexcept {
+        return reinterpret_cast<const std::uint64_t*>(_bytes() + offset);
+    }
+    bool _is_node(std::uint64_t offset) const noexcept {
+        const tensor_file_header& h = header();
+        const std::uint64_t bytes = offset - sizeof(h);
+        const std::uint64_t entry = bytes / sizeof(std::uint64_t);
+        return offset >= sizeof(h)
+            && bytes % sizeof(std::uint64_t) == 0
+            && entry / h.dimension < h.nodes
+            && entry % h.dimension == 0;
+    }
+    bool _is_leaf(std::uint64_t offset) const noexcept {
+        const tensor_file_header& h = header();
+        return offset >= h.leaf_offset
+            && (offset - h.leaf_offset) / sizeof(value_type) < h.leaves
+            && (offset - h.leaf_offset) % sizeof(value_type) == 0;
+    }
+    bool _valid() const noexcept {
+        const tensor_file_header& h = header();
+        const std::uint64_t table = _size - sizeof(h);
+        return std::memcmp(h.magic, h.signature, sizeof(h.magic)) == 0
+            && h.rank == rank
+            && h.element_size == sizeof(value_type)
+            && h.dimension != 0
+            && h.nodes <= table / sizeof(std::uint64_t) / h.dimension
+            && h.leaf_offset <= _size
+            && h.leaf_offset >= sizeof(h)
+                + h.nodes * h.dimension * sizeof(std::uint64_t)
+            && h.leaf_offset % alignof(value_type) == 0
+            && h.leaves <= (_size - h.leaf_offset) / sizeof(value_type)
+            && (h.root == 0 || _is_node(h.root));
+    }
+
+    // Implementation details: data members
+    private:
+    void* _data = nullptr;
+    std::size_t _size = 0;
+};
+/* ************************************************************************** */
+
+
+
+// ========================================================================== //
+} // namespace type_utilities
+#endif // _ALL_POINTERS_HPP_INCLUDED
+// ========================================================================== //
@@ -0,0 +1,153 @@
+// ============================ ATOMIC POINTERS ============================= //
+// Project:         Type Utilities
+// Name:            atomic_pointers.hpp
+// Description:     Lock-free concurrent insertion into nested-pointer tensors
+// Creator:         Vincent Reverdy
+// Contributor(s):  Vincent Reverdy [2018]
+// License:         BSD 3-Clause License
+// ========================================================================== //
+#ifndef _ATOMIC_POINTERS_HPP_INCLUDED
+#define _ATOMIC_POINTERS_HPP_INCLUDED
+// ========================================================================== //
+
+
+
+// ================================ PREAMBLE ================================ //
+// C++ standard library
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <type_traits>
+// Project sources
+#include "../include/type_utilities.hpp"
+// Third-party libraries
+// Miscellaneous
+namespace type_utilities {
+// ========================================================================== //
+
+
+
+/* **************************** ATOMIC POINTERS ***************************** */
+// Transforms a nested-pointer tensor type into a tensor of atomic pointers
+// whose elements are atomic values: type** becomes atomic<atomic<type>*>*
+template <class T, class = void>
+struct atomic_tensor
+{
+    using type = std::atomic<std::atomic<remove_all_pointers_t<T>>*>;
+};
+
+// Transforms a nested-pointer tensor type: interior levels
+template <class T>
+struct atomic_tensor<T, std::enable_if_t<
+    std::is_pointer_v<T> && std::is_pointer_v<std::remove_pointer_t<T>>
+>>
+{
+    using type = std::atomic<
+        typename atomic_tensor<std::remove_pointer_t<T>>::type*
+    >;
+};
+
+// Alias template
+template <class T>
+using atomic_tensor_t = typename atomic_tensor<T>::type;
+
+// Gets the element type of an atomic tensor
+template <class A>
+struct atomic_element
+{
+    using type = typename A::value_type;
+};
+
+// Gets the element type of an atomic tensor: atomic pointers
+template <class A>
+struct atomic_element<std::atomic<A*>>
+: atomic_element<A>
+{
+};
+
+// Alias template
+template <class A>
+using atomic_element_t = typename atomic_element<A>::type;
+
+// Enables if the atomic pointer points to a tensor element
+template <class A> using enable_if_atomic_element_t = std::enable_if_t<
+    std::is_same_v<typename A::value_type, std::atomic<atomic_element_t<A>>*>
+>;
+
+// Gets an element without waiting: tail
+template <class A, class = enable_if_atomic_element_t<A>>
+atomic_element_t<A> get_element(const A& tensor) {
+    const auto element = tensor.load(std::memory_order_acquire);
+    return element
+        ? element->load(std::memory_order_acquire)
+        : atomic_element_t<A>();
+}
+
+// Gets an element without waiting: recursive call
+template <class A, class... Indices>
+atomic_element_t<A> get_element(
+    const A& tensor, std::size_t idx, Indices&&... idxs
+) {
+    const auto node = tensor.load(std::memory_order_acquire);
+    return node
+        ? get_element(node[idx], std::forward<Indices>(idxs)...)
+        : atomic_element_t<A>();
+}
+
+// Sets an element concurrently: tail
+template <std::size_t N, class A, class = enable_if_atomic_element_t<A>>
+void set_element(const atomic_element_t<A>& val, A& tensor) {
+    using element_t = std::atomic<atomic_element_t<A>>;
+    element_t* element = tensor.load(std::memory_order_acquire);
+    if (!element) {
+        element_t* fresh = new element_t(val);
+        if (tensor.compare_exchange_strong(
+            element, fresh, std::memory_order_acq_rel, std::memory_order_acquire
+        )) {
+            return;
+        }
+        delete fresh;
+    }
+    element->store(val, std::memory_order_release);
+}
+
+// Sets an element concurrently: recursive call
+template <std::size_t N, class A, class... I>
+void set_element(
+    const atomic_element_t<A>& val, A& tensor, std::size_t idx, I&&... idxs
+) {
+    using node_t = std::remove_pointer_t<decltype(tensor.load())>;
+    node_t* node = tensor.load(std::memory_order_acquire);
+    if (!node) {
+        node_t* fresh = new node_t[N]();
+        if (tensor.compare_exchange_strong(
+            node, fresh, std::memory_order_acq_rel, std::memory_order_acquire
+        )) {
+            node = fresh;
+        } else {
+            delete[] fresh;
+        }
+    }
+    set_element<N>(val, node[idx], std::forward<I>(idxs)...);
+}
+
+// Deallocates the entire tensor once no other thread accesses it
+template <std::size_t N, class A>
+void deallocate(A& tensor) {
+    const auto node = tensor.load(std::memory_order_acquire);
+    if constexpr (!std::is_pointer_v<decltype(node->load())>) {
+        delete node;
+    } else if (node) {
+        for (std::size_t i = 0; i < N; ++i) deallocate<N>(node[i]);
+        delete[] node;
+    }
+    tensor.store(nullptr, std::memory_order_release);
+}
+/* ************************************************************************** */
+
+
+
+// ========================================================================== //
+} // namespace type_utilities
+#endif // _ATOMIC_POINTERS_HPP_INCLUDED
+// ========================================================================== //
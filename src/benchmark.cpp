@@ -0,0 +1,566 @@
+// =============================== BENCHMARK ================================ //
+// Project:         Type Utilities
+// Name:            benchmark.cpp
+// Description:     Runtime microbenchmarks and performance regression checks
+// Creator:         Vincent Reverdy
+// Contributor(s):  Vincent Reverdy [2018]
+// License:         BSD 3-Clause License
+// ========================================================================== //
+
+
+
+// ================================ PREAMBLE ================================ //
+// C++ standard library
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <algorithm>
+#include <functional>
+// Project sources
+#include "all_pointers.hpp"
+// Third-party libraries
+// Miscellaneous
+#if defined(__linux__)
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+using namespace type_utilities;
+// ========================================================================== //
+
+
+
+// ============================== MEASUREMENT =============================== //
+// Hardware counters reported per element when perf events are available
+constexpr std::size_t counter_count = 3;
+constexpr const char* counter_names[counter_count] = {
+    "cycles", "cache_misses", "branch_misses"
+};
+
+// A group of hardware counters read through perf_event_open on Linux
+class perf_counters
+{
+    // Lifecycle
+    public:
+    perf_counters() {
+#if defined(__linux__)
+        constexpr std::uint64_t configs[counter_count] = {
+            PERF_COUNT_HW_CPU_CYCLES,
+            PERF_COUNT_HW_CACHE_MISSES,
+            PERF_COUNT_HW_BRANCH_MISSES
+        };
+        for (std::size_t i = 0; i < counter_count; ++i) {
+            perf_event_attr attr = {};
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.size = sizeof(attr);
+            attr.config = configs[i];
+            attr.disabled = i == 0;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP;
+            _files[i] = static_cast<int>(::syscall(
+                SYS_perf_event_open, &attr, 0, -1, i == 0 ? -1 : _files[0], 0
+            ));
+            if (_files[i] < 0) {
+                _close();
+                break;
+            }
+        }
+#endif
+    }
+    perf_counters(const perf_counters&) = delete;
+    perf_counters& operator=(const perf_counters&) = delete;
+    ~perf_counters() {
+        _close();
+    }
+
+    // Measurement
+    public:
+    bool available() const noexcept {
+        return _files[0] >= 0;
+    }
+    void start() {
+#if defined(__linux__)
+        if (available()) {
+            ::ioctl(_files[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+            ::ioctl(_files[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        }
+#endif
+    }
+    std::array<double, counter_count> stop() {
+        std::array<double, counter_count> result = {};
+#if defined(__linux__)
+        std::uint64_t values[counter_count + 1] = {};
+        if (available()) {
+            ::ioctl(_files[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+            if (::read(_files[0], values, sizeof(values)) == sizeof(values)) {
+                for (std::size_t i = 0; i < counter_count; ++i) {
+                    result[i] = static_cast<double>(values[i + 1]);
+                }
+            }
+        }
+#endif
+        return result;
+    }
+
+    // Implementation details
+    private:
+    void _close() noexcept {
+        for (int& file: _files) {
+#if defined(__linux__)
+            if (file >= 0) ::close(file);
+#endif
+            file = -1;
+        }
+    }
+    int _files[counter_count] = {-1, -1, -1};
+};
+
+// A workload: only run is measured, setup and teardown surround each run,
+// and cleanup releases the state shared by all the runs
+struct workload
+{
+    std::string name;
+    std::size_t elements;
+    std::function<void()> setup;
+    std::function<void()> run;
+    std::function<void()> teardown;
+    std::function<void()> cleanup;
+};
+
+// The statistics of a workload, in nanoseconds and counts per element: best is
+// the fastest sample of a round, or the median of the best times it combines,
+// and noise is the range of those best times relative to their median
+struct result
+{
+    std::string name;
+    std::size_t elements = 0;
+    std::size_t rounds = 1;
+    std::size_t samples = 0;
+    double best = 0;
+    double noise = 0;
+    double median = 0;
+    double max = 0;
+    double mean = 0;
+    bool has_counters = false;
+    std::array<double, counter_count> counters = {};
+};
+
+// Options of the benchmark executable
+struct options
+{
+    std::size_t warmup = 3;
+    std::size_t samples = 25;
+    double min_time = 1e6;
+    std::size_t rounds = 5;
+    bool perf = false;
+    double threshold = 0.10;
+    std::string filter;
+    std::string json;
+    std::string baseline;
+};
+
+// Computes the median of values
+double median(std::vector<double> values) {
+    const std::size_t n = values.size();
+    std::sort(values.begin(), values.end());
+    return n % 2 ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2;
+}
+
+// Measures a workload after warming it up: each sample, including the
+// discarded warmup samples, repeats the workload until its measured runs last
+// at least the minimum time, so that short workloads are not dominated by
+// timer resolution and scheduling noise
+result measure(const workload& w, const options& opts, perf_counters& perf) {
+    using clock = std::chrono::steady_clock;
+    std::vector<double> times;
+    std::array<std::vector<double>, counter_count> counts;
+    result r;
+    for (std::size_t i = 0; i < opts.warmup + opts.samples; ++i) {
+        std::chrono::duration<double, std::nano> time(0);
+        std::array<double, counter_count> values = {};
+        std::size_t runs = 0;
+        for (; runs == 0 || time.count() < opts.min_time; ++runs) {
+            w.setup();
+            if (opts.perf) perf.start();
+            const auto start = clock::now();
+            w.run();
+            time += clock::now() - start;
+            const auto run = opts.perf ? perf.stop() : decltype(perf.stop())();
+            w.teardown();
+            for (std::size_t c = 0; c < counter_count; ++c) values[c] += run[c];
+        }
+        if (i < opts.warmup) continue;
+        times.push_back(time.count() / (runs * w.elements));
+        for (std::size_t c = 0; c < counter_count; ++c) {
+            counts[c].push_back(values[c] / (runs * w.elements));
+        }
+    }
+    w.cleanup();
+    r.name = w.name;
+    r.elements = w.elements;
+    r.samples = times.size();
+    r.best = *std::min_element(times.begin(), times.end());
+    r.median = median(times);
+    r.max = *std::max_element(times.begin(), times.end());
+    for (double time: times) r.mean += time / times.size();
+    r.has_counters = opts.perf && perf.available();
+    for (std::size_t c = 0; c < counter_count && r.has_counters; ++c) {
+        r.counters[c] = median(counts[c]);
+    }
+    return r;
+}
+
+// Combines the results of a workload measured in several rounds, or in several
+// runs of the executable: the median of their best times is robust to a slow
+// round, and the range of those best times measures the noise of the machine
+result combine(const std::vector<result>& rounds) {
+    result r = rounds.front();
+    std::vector<double> values(rounds.size());
+    const auto collect = [&](auto member) -> std::vector<double>& {
+        for (std::size_t k = 0; k < rounds.size(); ++k) {
+            values[k] = rounds[k].*member;
+        }
+        return values;
+    };
+    r.rounds = 0;
+    r.samples = 0;
+    r.best = median(collect(&result::best));
+    r.noise = (*std::max_element(values.begin(), values.end())
+        - *std::min_element(values.begin(), values.end())) / r.best;
+    for (const result& round: rounds) {
+        r.rounds += round.rounds;
+        r.samples += round.samples;
+        r.max = std::max(r.max, round.max);
+    }
+    r.median = median(collect(&result::median));
+    r.mean = 0;
+    for (const result& round: rounds) r.mean += round.mean / rounds.size();
+    for (std::size_t c = 0; c < counter_count && r.has_counters; ++c) {
+        for (std::size_t k = 0; k < rounds.size(); ++k) {
+            values[k] = rounds[k].counters[c];
+        }
+        r.counters[c] = median(values);
+    }
+    return r;
+}
+// ========================================================================== //
+
+
+
+// ================================ REPORTING =============================== //
+// Writes results as JSON, with one benchmark per line to ease diffing
+void write_json(std::ostream& stream, const std::vector<result>& results) {
+    stream << "{\n  \"unit\": \"ns/element\",\n  \"benchmarks\": [\n";
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        const result& r = results[i];
+        stream << "    {\"name\": \"" << r.name << "\", \"elements\": ";
+        stream << r.elements << ", \"rounds\": " << r.rounds;
+        stream << ", \"samples\": " << r.samples;
+        stream << ", \"best_ns\": " << r.best << ", \"noise\": " << r.noise;
+        stream << ", \"median_ns\": " << r.median << ", \"max_ns\": " << r.max;
+        stream << ", \"mean_ns\": " << r.mean;
+        for (std::size_t c = 0; c < counter_count && r.has_counters; ++c) {
+            stream << ", \"" << counter_names[c] << "\": " << r.counters[c];
+        }
+        stream << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    stream << "  ]\n}\n";
+}
+
+// Reads a number following a key in a line of a file written by write_json,
+// or returns zero if the key is missing
+double read_number(const std::string& line, const std::string& key) {
+    const std::size_t position = line.find("\"" + key + "\": ");
+    return position != std::string::npos
+        ? std::stod(line.substr(position + key.size() + 4))
+        : 0;
+}
+
+// Reads the results of a file written by write_json
+std::vector<result> read_json(std::istream& stream) {
+    std::vector<result> results;
+    const std::string name_key = "\"name\": \"";
+    for (std::string line; std::getline(stream, line);) {
+        const std::size_t name = line.find(name_key);
+        if (name != std::string::npos) {
+            const std::size_t first = name + name_key.size();
+            result r;
+            r.name = line.substr(first, line.find('"', first) - first);
+            r.elements = read_number(line, "elements");
+            r.rounds = read_number(line, "rounds");
+            r.samples = read_number(line, "samples");
+            r.best = read_number(line, "best_ns");
+            r.noise = read_number(line, "noise");
+            r.median = read_number(line, "median_ns");
+            r.max = read_number(line, "max_ns");
+            r.mean = read_number(line, "mean_ns");
+            r.has_counters = line.find(counter_names[0]) != std::string::npos;
+            for (std::size_t c = 0; c < counter_count && r.has_counters; ++c) {
+                r.counters[c] = read_number(line, counter_names[c]);
+            }
+            results.push_back(r);
+        }
+    }
+    return results;
+}
+
+// Displays a result as a table row
+void display(const result& r) {
+    std::cout << std::left << std::setw(20) << r.name << std::right;
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << std::setw(12) << r.best << std::setw(12) << r.median;
+    std::cout << std::setw(12) << r.max;
+    std::cout << std::setw(9) << std::setprecision(1) << r.noise * 100 << "%";
+    std::cout << std::setprecision(3);
+    for (std::size_t c = 0; c < counter_count && r.has_counters; ++c) {
+        std::cout << std::setw(14) << r.counters[c];
+    }
+    std::cout << std::defaultfloat << "\n";
+}
+
+// Finds the result of a benchmark in a baseline, or null if it has none
+const result* find_result(
+    const std::string& name, const std::vector<result>& baseline
+) {
+    const auto it = std::find_if(baseline.begin(), baseline.end(),
+        [&name](const result& entry){return entry.name == name;}
+    );
+    return it != baseline.end() ? &*it : nullptr;
+}
+
+// Compares results with a baseline, returning the number of regressions: a
+// best time regresses when it grows by more than the threshold and by more
+// than the noise of the baseline, so that a benchmark whose best time varies
+// widely from run to run only fails the gate on a larger change
+std::size_t compare(
+    const std::vector<result>& results,
+    const std::vector<result>& baseline,
+    double threshold
+) {
+    std::size_t regressions = 0;
+    std::cout << "\n" << std::left << std::setw(20) << "baseline" << std::right;
+    std::cout << std::setw(12) << "before" << std::setw(12) << "after";
+    std::cout << std::setw(10) << "change" << std::setw(10) << "allowed";
+    std::cout << "\n";
+    for (const result& r: results) {
+        const result* before = find_result(r.name, baseline);
+        if (before && before->best > 0) {
+            const double change = r.best / before->best - 1;
+            const double allowed = std::max(threshold, before->noise);
+            const bool regression = change > allowed;
+            regressions += regression;
+            std::cout << std::left << std::setw(20) << r.name << std::right;
+            std::cout << std::fixed << std::setprecision(3);
+            std::cout << std::setw(12) << before->best;
+            std::cout << std::setw(12) << r.best;
+            std::cout << std::setw(9) << std::setprecision(1) << change * 100;
+            std::cout << "%" << std::setw(9) << allowed * 100 << "%";
+            std::cout << (regression ? "  REGRESSION" : "") << "\n";
+            std::cout << std::defaultfloat;
+        }
+    }
+    return regressions;
+}
+// ========================================================================== //
+
+
+
+// ================================ WORKLOADS =============================== //
+// A sink preventing the elimination of measured reads
+volatile unsigned long long int sink = 0;
+
+// Fills a tensor in row-major order with its linearized indices
+template <std::size_t N, class T>
+void fill(T& tensor) {
+    std::size_t i = 0;
+    for (std::size_t i0 = 0; i0 < N; ++i0) {
+        for (std::size_t i1 = 0; i1 < N; ++i1) {
+            for (std::size_t i2 = 0; i2 < N; ++i2) {
+                for (std::size_t i3 = 0; i3 < N; ++i3) {
+                    set_element<N>(i++, tensor, i0, i1, i2, i3);
+                }
+            }
+        }
+    }
+}
+
+// Reads a whole tensor in row-major order
+template <std::size_t N, class T>
+void get(T& tensor) {
+    remove_all_pointers_t<T> sum = 0;
+    for (std::size_t i0 = 0; i0 < N; ++i0) {
+        for (std::size_t i1 = 0; i1 < N; ++i1) {
+            for (std::size_t i2 = 0; i2 < N; ++i2) {
+                for (std::size_t i3 = 0; i3 < N; ++i3) {
+                    sum += get_element(tensor, i0, i1, i2, i3);
+                }
+            }
+        }
+    }
+    sink = sink + sum;
+}
+
+// Adds the fill, get and deallocate workloads of a dimension
+template <std::size_t N>
+void add_all_pointers(std::vector<workload>& workloads) {
+    using type = unsigned long long int;
+    static type***** tensor = nullptr;
+    const std::string suffix = "/" + std::to_string(N);
+    const std::size_t elements = N * N * N * N;
+    const auto nothing = []{};
+    const auto release = []{deallocate<N>(tensor);};
+    workloads.push_back({
+        "fill" + suffix, elements, nothing, []{fill<N>(tensor);},
+        release, nothing
+    });
+    workloads.push_back({
+        "get" + suffix, elements, []{if (!tensor) fill<N>(tensor);},
+        []{get<N>(tensor);}, nothing, release
+    });
+    workloads.push_back({
+        "deallocate" + suffix, elements, []{fill<N>(tensor);}, release,
+        nothing, nothing
+    });
+}
+// ========================================================================== //
+
+
+
+// ================================== MAIN ================================== //
+// Main function
+int main(int argc, char** argv)
+{
+    // Initialization
+    options opts;
+    std::vector<workload> workloads;
+    std::vector<const workload*> measured;
+    std::vector<std::vector<result>> rounds;
+    std::vector<result> results;
+    std::vector<result> baseline;
+    std::vector<std::string> merged;
+    const std::string usage = std::string("usage: ") + argv[0]
+        + " [--warmup n] [--samples n] [--min-time ms] [--rounds n] [--perf]"
+        + " [--filter substring] [--json file] [--baseline file]"
+        + " [--threshold fraction] [--merge file...]\n";
+
+    // Options
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const bool has_value = i + 1 < argc;
+        if (arg == "--perf") {
+            opts.perf = true;
+        } else if (arg == "--warmup" && has_value) {
+            opts.warmup = std::stoul(argv[++i]);
+        } else if (arg == "--samples" && has_value) {
+            opts.samples = std::max(1UL, std::stoul(argv[++i]));
+        } else if (arg == "--min-time" && has_value) {
+            opts.min_time = std::stod(argv[++i]) * 1e6;
+        } else if (arg == "--rounds" && has_value) {
+            opts.rounds = std::max(1UL, std::stoul(argv[++i]));
+        } else if (arg == "--filter" && has_value) {
+            opts.filter = argv[++i];
+        } else if (arg == "--json" && has_value) {
+            opts.json = argv[++i];
+        } else if (arg == "--baseline" && has_value) {
+            opts.baseline = argv[++i];
+        } else if (arg == "--threshold" && has_value) {
+            opts.threshold = std::stod(argv[++i]);
+        } else if (arg == "--merge" && has_value) {
+            merged.assign(argv + i + 1, argv + argc);
+            i = argc;
+        } else {
+            std::cerr << usage;
+            return 2;
+        }
+    }
+
+    // Merging: the results of several runs are combined like rounds
+    if (!merged.empty()) {
+        for (const std::string& file: merged) {
+            std::ifstream stream(file);
+            if (!stream) {
+                std::cerr << "cannot read results " << file << "\n";
+                return 2;
+            }
+            for (const result& r: read_json(stream)) {
+                const auto it = std::find_if(rounds.begin(), rounds.end(),
+                    [&r](const auto& runs){return runs.front().name == r.name;}
+                );
+                if (it != rounds.end()) it->push_back(r);
+                else rounds.push_back({r});
+            }
+        }
+        for (const std::vector<result>& runs: rounds) {
+            results.push_back(combine(runs));
+        }
+        std::ofstream stream;
+        if (!opts.json.empty()) stream.open(opts.json);
+        write_json(opts.json.empty() ? std::cout : stream, results);
+        return 0;
+    }
+
+    // Baseline
+    if (!opts.baseline.empty()) {
+        std::ifstream stream(opts.baseline);
+        if (!stream) {
+            std::cerr << "cannot read baseline " << opts.baseline << "\n";
+            return 2;
+        }
+        baseline = read_json(stream);
+    }
+
+    // Workloads
+    add_all_pointers<4>(workloads);
+    add_all_pointers<8>(workloads);
+    add_all_pointers<16>(workloads);
+    add_all_pointers<32>(workloads);
+
+    // Measurement
+    perf_counters perf;
+    if (opts.perf && !perf.available()) {
+        std::cerr << "perf_event_open unavailable: counters disabled\n";
+    }
+    opts.perf = opts.perf && perf.available();
+    std::cout << std::left << std::setw(20) << "benchmark" << std::right;
+    std::cout << std::setw(12) << "best" << std::setw(12) << "median";
+    std::cout << std::setw(12) << "max" << std::setw(10) << "noise";
+    for (std::size_t c = 0; c < counter_count && perf.available(); ++c) {
+        std::cout << std::setw(14) << counter_names[c];
+    }
+    std::cout << "\n";
+    for (const workload& w: workloads) {
+        if (w.name.find(opts.filter) != std::string::npos) {
+            measured.push_back(&w);
+        }
+    }
+    rounds.resize(measured.size());
+    for (std::size_t i = 0; i < opts.rounds; ++i) {
+        for (std::size_t k = 0; k < measured.size(); ++k) {
+            rounds[k].push_back(measure(*measured[k], opts, perf));
+        }
+    }
+    for (const std::vector<result>& r: rounds) {
+        results.push_back(combine(r));
+        display(results.back());
+    }
+
+    // Reporting
+    if (!opts.json.empty()) {
+        std::ofstream stream(opts.json);
+        write_json(stream, results);
+    }
+    if (!opts.baseline.empty()) {
+        return compare(results, baseline, opts.threshold) ? 1 : 0;
+    }
+
+    // Finalization
+    return 0;
+}
+// ========================================================================== //
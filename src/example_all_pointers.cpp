@@ -11,10 +11,17 @@
 
 // ================================ PREAMBLE ================================ //
 // C++ standard library
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <numeric>
+#include <optional>
+#include <random>
+#include <string>
 #include <vector>
 #include <iostream>
 // Project sources
-#include "../include/type_utilities.hpp"
+#include "all_pointers.hpp"
 // Third-party libraries
 // Miscellaneous
 using namespace type_utilities;
@@ -22,60 +29,256 @@ using namespace type_utilities;
 
 
 
-// ============================= IMPLEMENTATION ============================= //
-// Enables if the type is a pointer to a tensor element
-template <class T> using enable_if_element_pointer_t = std::enable_if_t<
-    std::is_pointer_v<T> && !std::is_pointer_v<std::remove_pointer_t<T>>
->;
+// =============================== BENCHMARK ================================ //
+// Measures the best wall-clock time of a function in nanoseconds per element
+template <class F>
+double benchmark(std::size_t count, std::size_t repetitions, F&& f) {
+    using clock = std::chrono::steady_clock;
+    double best = 0;
+    for (std::size_t r = 0; r < repetitions; ++r) {
+        const auto start = clock::now();
+        f();
+        const std::chrono::duration<double, std::nano> time
+            = clock::now() - start;
+        best = r == 0 || time.count() < best ? time.count() : best;
+    }
+    return best / count;
+}
 
-// Gets an element: tail
-template <class T, class = enable_if_element_pointer_t<T>>
-constexpr remove_all_pointers_t<T> get_element(T& tensor) {
-    return tensor ? *tensor : remove_all_pointers_t<T>();
+// Loads a range of elements in a tensor, one index tuple at a time
+template <std::size_t N, class T, class Indices, class Values>
+void load_elements(T& tensor, const Indices& indices, const Values& values) {
+    for (std::size_t i = 0; i < std::size(indices); ++i) {
+        const auto [i0, i1, i2, i3] = indices[i];
+        set_element<N>(values[i], tensor, i0, i1, i2, i3);
+    }
 }
 
-// Gets an element: recursive call
-template <class T, class... Indices>
-constexpr remove_all_pointers_t<T> get_element(
-    T& tensor, std::size_t idx, Indices&&... idxs
-) {
-    return tensor && tensor[idx]
-        ? get_element(tensor[idx], std::forward<Indices>(idxs)...)
-        : remove_all_pointers_t<T>();
+// Compares runtime and prefetched gathers on a large tensor, and checks that
+// they read the same elements
+bool benchmark_gather() {
+    constexpr std::size_t dimension = 56;
+    constexpr std::size_t repetitions = 5;
+    constexpr std::size_t count = 1 << 20;
+    using type = unsigned long long int;
+    using index = tensor_index_t<type*****>;
+    type***** tensor = nullptr;
+    std::vector<index> indices;
+    std::vector<type> values;
+    std::vector<type> expected(count);
+    std::vector<type> gathered(count);
+    std::mt19937_64 engine;
+    std::uniform_int_distribution<std::size_t> distribution(0, dimension - 1);
+    type sum = 0;
+    std::size_t mismatches = 0;
+
+    // Fill in row-major order, gather in random order
+    for (std::size_t i0 = 0; i0 < dimension; ++i0) {
+        for (std::size_t i1 = 0; i1 < dimension; ++i1) {
+            for (std::size_t i2 = 0; i2 < dimension; ++i2) {
+                for (std::size_t i3 = 0; i3 < dimension; ++i3) {
+                    indices.push_back(index{i0, i1, i2, i3});
+                    values.push_back(values.size());
+                }
+            }
+        }
+    }
+    load_elements<dimension>(tensor, indices, values);
+    indices.resize(count);
+    for (index& idx: indices) {
+        for (std::size_t& i: idx) i = distribution(engine);
+    }
+
+    // Gathering
+    const double get_loop = benchmark(count, repetitions, [&]{
+        for (std::size_t i = 0; i < count; ++i) {
+            const index& idx = indices[i];
+            expected[i] = get_element(tensor, idx[0], idx[1], idx[2], idx[3]);
+        }
+        sum += expected.back();
+    });
+    const double get_gather = benchmark(count, repetitions, [&]{
+        gather_elements(tensor, indices, gathered);
+        sum += gathered.back();
+    });
+    deallocate<dimension>(tensor);
+    for (std::size_t i = 0; i < count; ++i) {
+        mismatches += gathered[i] != expected[i];
+    }
+
+    // Display
+    std::cout << "[benchmark] " << values.size() << " elements, " << count;
+    std::cout << " random gathers (" << sum << ", " << mismatches;
+    std::cout << " mismatches)\n";
+    std::cout << "get_element loop:  " << get_loop << " ns/element\n";
+    std::cout << "gather_elements:   " << get_gather << " ns/element\n";
+    return mismatches == 0;
 }
 
-// Sets an element: tail
-template <std::size_t N, class T, class = enable_if_element_pointer_t<T>>
-void set_element(const remove_all_pointers_t<T>& val, T& tensor) {
-    using raw_t = remove_all_pointers_t<T>;
-    tensor ? (*tensor = val, 0) : (tensor = new raw_t(val), 0);
+// Compares compile-time and runtime indices reading the same element of many
+// small tensors, so that each read walks a distinct path, and checks that both
+// read the same elements
+bool benchmark_static() {
+    constexpr std::size_t dimension = 4;
+    constexpr std::size_t repetitions = 5;
+    constexpr std::size_t count = 1 << 18;
+    using type = unsigned long long int;
+    std::vector<type*****> tensors(count, nullptr);
+    std::vector<type> expected(count);
+    std::vector<type> gathered(count);
+    volatile std::size_t runtime[] = {1, 2, 3, 0};
+    type sum = 0;
+    std::size_t mismatches = 0;
+
+    // Fill one row of each tensor
+    for (std::size_t i = 0; i < count; ++i) {
+        for (std::size_t i3 = 0; i3 < dimension; ++i3) {
+            set_element<dimension>(i + i3, tensors[i], 1, 2, 3, i3);
+        }
+    }
+
+    // Reading
+    const double get_static = benchmark(count, repetitions, [&]{
+        for (std::size_t i = 0; i < count; ++i) {
+            gathered[i] = get_element<1, 2, 3, 0>(tensors[i]);
+        }
+        sum += gathered.back();
+    });
+    const double get_dynamic = benchmark(count, repetitions, [&]{
+        const std::size_t i0 = runtime[0];
+        const std::size_t i1 = runtime[1];
+        const std::size_t i2 = runtime[2];
+        const std::size_t i3 = runtime[3];
+        for (std::size_t i = 0; i < count; ++i) {
+            expected[i] = get_element(tensors[i], i0, i1, i2, i3);
+        }
+        sum += expected.back();
+    });
+    for (type*****& tensor: tensors) deallocate<dimension>(tensor);
+    for (std::size_t i = 0; i < count; ++i) {
+        mismatches += gathered[i] != expected[i];
+    }
+
+    // Display
+    std::cout << "[benchmark] one element of " << count << " tensors (";
+    std::cout << sum << ", " << mismatches << " mismatches)\n";
+    std::cout << "get_element<I...>: " << get_static << " ns/element\n";
+    std::cout << "get_element(i...): " << get_dynamic << " ns/element\n";
+    return mismatches == 0;
 }
 
-// Sets an element: recursive call
-template <std::size_t N, class T, class... I>
-void set_element(
-    const remove_all_pointers_t<T>& val, T& tensor, std::size_t idx, I&&... idxs
-) {
-    if (!tensor) {
-        tensor = new std::remove_pointer_t<T>[N];
-        for (std::size_t i = 0; i < N; ++i) tensor[i] = nullptr;
+// Compares index-based and cursor-based scans of a whole tensor, and checks
+// that all of them compute the same sum
+bool benchmark_scan() {
+    constexpr std::size_t dimension = 32;
+    constexpr std::size_t repetitions = 5;
+    constexpr std::size_t count = dimension * dimension * dimension * dimension;
+    using type = unsigned long long int;
+    type***** tensor = nullptr;
+    type sums[3] = {};
+    std::size_t i = 0;
+
+    // Fill
+    for (std::size_t i0 = 0; i0 < dimension; ++i0) {
+        for (std::size_t i1 = 0; i1 < dimension; ++i1) {
+            for (std::size_t i2 = 0; i2 < dimension; ++i2) {
+                for (std::size_t i3 = 0; i3 < dimension; ++i3) {
+                    set_element<dimension>(i++, tensor, i0, i1, i2, i3);
+                }
+            }
+        }
     }
-    set_element<N>(val, tensor[idx], std::forward<I>(idxs)...);
+
+    // Scans
+    const double scan_loop = benchmark(count, repetitions, [&]{
+        type sum = 0;
+        for (std::size_t i0 = 0; i0 < dimension; ++i0) {
+            for (std::size_t i1 = 0; i1 < dimension; ++i1) {
+                for (std::size_t i2 = 0; i2 < dimension; ++i2) {
+                    for (std::size_t i3 = 0; i3 < dimension; ++i3) {
+                        sum += get_element(tensor, i0, i1, i2, i3);
+                    }
+                }
+            }
+        }
+        sums[0] = sum;
+    });
+    const double scan_cursor = benchmark(count, repetitions, [&]{
+        auto [first, last] = make_cursors<dimension>(tensor);
+        type sum = 0;
+        for (; first != last; ++first) sum += *first;
+        sums[1] = sum;
+    });
+    const double scan_accumulate = benchmark(count, repetitions, [&]{
+        auto [first, last] = make_cursors<dimension>(tensor);
+        sums[2] = std::accumulate(first, last, type());
+    });
+    deallocate<dimension>(tensor);
+
+    // Display
+    std::cout << "[benchmark] scan of " << count << " elements (" << sums[0];
+    std::cout << ", " << sums[1] << ", " << sums[2] << ")\n";
+    std::cout << "get_element loop:  " << scan_loop << " ns/element\n";
+    std::cout << "tensor_cursor:     " << scan_cursor << " ns/element\n";
+    std::cout << "std::accumulate:   " << scan_accumulate << " ns/element\n";
+    return sums[0] == sums[1] && sums[0] == sums[2];
 }
 
-// Deallocates the entire tensor
-template <std::size_t N, class T>
-void deallocate(T& tensor) {
-    if constexpr (!std::is_pointer_v<std::remove_pointer_t<T>>) {
-        delete tensor;
-        tensor = nullptr;
-    } else if constexpr (std::is_pointer_v<std::remove_pointer_t<T>>) {
-        if (tensor) {
-            for (std::size_t i = 0; i < N; ++i) deallocate<N>(tensor[i]);
-            delete[] tensor;
-            tensor = nullptr;
+// Compares rebuilding a tensor with mapping its checkpoint, and checks that
+// the mapped elements match the rebuilt ones
+bool benchmark_checkpoint(const std::string& path) {
+    constexpr std::size_t dimension = 32;
+    using type = unsigned long long int;
+    using index = tensor_index_t<type*****>;
+    type***** tensor = nullptr;
+    std::vector<index> indices;
+    std::vector<type> values;
+    std::size_t mismatches = 0;
+
+    // Checkpoint
+    for (std::size_t i0 = 0; i0 < dimension; ++i0) {
+        for (std::size_t i1 = 0; i1 < dimension; ++i1) {
+            for (std::size_t i2 = 0; i2 < dimension; ++i2) {
+                for (std::size_t i3 = 0; i3 < dimension; ++i3) {
+                    indices.push_back(index{i0, i1, i2, i3});
+                    values.push_back(values.size() * (i3 % 3 != 0));
+                }
+            }
         }
     }
+    load_elements<dimension>(tensor, indices, values);
+    const double save = benchmark(1, 1, [&]{
+        save_tensor<dimension>(tensor, path);
+    });
+    deallocate<dimension>(tensor);
+
+    // Restart
+    const double rebuild = benchmark(1, 1, [&]{
+        load_elements<dimension>(tensor, indices, values);
+    });
+    std::optional<mapped_tensor<type*****>> mapped;
+    const double map = benchmark(1, 1, [&]{
+        mapped.emplace(path);
+    });
+    const double read = benchmark(indices.size(), 1, [&]{
+        for (const index& idx: indices) {
+            const auto [i0, i1, i2, i3] = idx;
+            const type x = mapped->get_element(i0, i1, i2, i3);
+            mismatches += x != get_element(tensor, i0, i1, i2, i3);
+        }
+    });
+    deallocate<dimension>(tensor);
+    mapped.reset();
+    std::remove(path.c_str());
+
+    // Display
+    std::cout << "[benchmark] checkpoint of " << indices.size() << " elements";
+    std::cout << " (" << mismatches << " mismatches)\n";
+    std::cout << "save_tensor:       " << save / 1e6 << " ms\n";
+    std::cout << "set_element loop:  " << rebuild / 1e6 << " ms\n";
+    std::cout << "mapped_tensor:     " << map / 1e6 << " ms\n";
+    std::cout << "first full read:   " << read << " ns/element\n";
+    return mismatches == 0;
 }
 // ========================================================================== //
 
@@ -83,13 +286,14 @@ void deallocate(T& tensor) {
 
 // ================================== MAIN ================================== //
 // Main function
-int main(int, char**)
+int main(int argc, char** argv)
 {
     // Initialization
     constexpr std::size_t dimension = 4;
     using type = unsigned long long int;
     type***** tensor = nullptr;
     std::size_t i = 0;
+    bool success = true;
 
     // Fill
     for (std::size_t i0 = 0; i0 < dimension; ++i0) {
@@ -115,8 +319,17 @@ int main(int, char**)
         }
     }
     
+    // Benchmark
+    if (argc > 1 && std::string(argv[1]) == "--benchmark") {
+        success = benchmark_gather() && success;
+        success = benchmark_static() && success;
+        success = benchmark_scan() && success;
+        const char* path = argc > 2 ? argv[2] : "all_pointers.tensor";
+        success = benchmark_checkpoint(path) && success;
+    }
+    
     // Finalization
     deallocate<dimension>(tensor);
-    return 0;
+    return success ? 0 : 1;
 }
 // ========================================================================== //
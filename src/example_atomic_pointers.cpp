@@ -0,0 +1,210 @@
+// ======================== EXAMPLE ATOMIC POINTERS ========================= //
+// Project:         Type Utilities
+// Name:            example_atomic_pointers.cpp
+// Description:     Stress tests and scaling of lock-free tensor insertion
+// Creator:         Vincent Reverdy
+// Contributor(s):  Vincent Reverdy [2018]
+// License:         BSD 3-Clause License
+// ========================================================================== //
+
+
+
+// ================================ PREAMBLE ================================ //
+// C++ standard library
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <iostream>
+// Project sources
+#include "atomic_pointers.hpp"
+// Third-party libraries
+// Miscellaneous
+using namespace type_utilities;
+// ========================================================================== //
+
+
+
+// =============================== BENCHMARK ================================ //
+// Tensor parameters shared by the stress tests and the benchmark
+constexpr std::size_t dimension = 16;
+constexpr std::size_t benchmark_dimension = 32;
+using type = unsigned long long int;
+using tensor_type = atomic_tensor_t<type*****>;
+
+// Inserts the elements of a strided slice of the tensor, row-major linearized
+template <std::size_t N, class Insert>
+void insert_slice(std::size_t first, std::size_t stride, Insert&& insert) {
+    constexpr std::size_t size = N * N * N * N;
+    for (std::size_t i = first; i < size; i += stride) {
+        const std::size_t i0 = i / (N * N * N);
+        const std::size_t i1 = i / (N * N) % N;
+        const std::size_t i2 = i / N % N;
+        const std::size_t i3 = i % N;
+        insert(i + 1, i0, i1, i2, i3);
+    }
+}
+
+// Runs writers on interleaved slices, racing to allocate the same interior
+// nodes, while readers check that published values are never torn
+bool stress(std::size_t writers, std::size_t readers) {
+    tensor_type tensor{nullptr};
+    std::atomic<bool> done{false};
+    std::atomic<std::size_t> errors{0};
+    std::vector<std::thread> threads;
+    for (std::size_t t = 0; t < writers; ++t) {
+        threads.emplace_back([&tensor, t, writers]{
+            insert_slice<dimension>(t, writers, [&](type val, auto... idxs){
+                set_element<dimension>(val, tensor, idxs...);
+            });
+        });
+    }
+    for (std::size_t t = 0; t < readers; ++t) {
+        threads.emplace_back([&]{
+            while (!done.load()) {
+                insert_slice<dimension>(0, 7, [&](type val, auto... idxs){
+                    const type x = get_element(tensor, idxs...);
+                    errors += x != 0 && x != val;
+                });
+            }
+        });
+    }
+    for (std::size_t t = 0; t < writers; ++t) threads[t].join();
+    done.store(true);
+    for (std::size_t t = writers; t < threads.size(); ++t) threads[t].join();
+    insert_slice<dimension>(0, 1, [&](type val, auto... idxs){
+        errors += get_element(tensor, idxs...) != val;
+    });
+    deallocate<dimension>(tensor);
+    return errors == 0;
+}
+
+// Runs writers inserting every element of the tensor, each writer with its
+// own values, racing to allocate the same interior nodes and leaves: readers
+// and the final verification check that every value is one of those written
+bool contend(std::size_t writers, std::size_t readers) {
+    tensor_type tensor{nullptr};
+    std::atomic<bool> done{false};
+    std::atomic<std::size_t> errors{0};
+    std::atomic<std::size_t> ready{0};
+    std::vector<std::thread> threads;
+    const auto written = [writers](type x, type val) {
+        return x != 0 && (x - 1) / writers == val - 1;
+    };
+    for (std::size_t t = 0; t < writers; ++t) {
+        threads.emplace_back([&tensor, &ready, t, writers]{
+            for (++ready; ready.load() != writers;) std::this_thread::yield();
+            insert_slice<dimension>(0, 1, [&](type val, auto... idxs){
+                set_element<dimension>(
+                    (val - 1) * writers + t + 1, tensor, idxs...
+                );
+            });
+        });
+    }
+    for (std::size_t t = 0; t < readers; ++t) {
+        threads.emplace_back([&]{
+            while (!done.load()) {
+                insert_slice<dimension>(0, 7, [&](type val, auto... idxs){
+                    const type x = get_element(tensor, idxs...);
+                    errors += x != 0 && !written(x, val);
+                });
+            }
+        });
+    }
+    for (std::size_t t = 0; t < writers; ++t) threads[t].join();
+    done.store(true);
+    for (std::size_t t = writers; t < threads.size(); ++t) threads[t].join();
+    insert_slice<dimension>(0, 1, [&](type val, auto... idxs){
+        errors += !written(get_element(tensor, idxs...), val);
+    });
+    deallocate<dimension>(tensor);
+    return errors == 0;
+}
+
+// Measures the best insertion throughput over repeated runs in millions of
+// elements per second: threads wait at a start gate, so that each run is
+// timed from the gate to the last join and excludes thread creation
+template <class Insert, class Reset>
+double throughput(std::size_t threads, Insert&& insert, Reset&& reset) {
+    using clock = std::chrono::steady_clock;
+    constexpr std::size_t repetitions = 5;
+    constexpr std::size_t n = benchmark_dimension;
+    double best = 0;
+    for (std::size_t r = 0; r < repetitions; ++r) {
+        std::atomic<std::size_t> ready{0};
+        std::atomic<bool> start{false};
+        std::vector<std::thread> pool;
+        for (std::size_t t = 0; t < threads; ++t) {
+            pool.emplace_back([&insert, &ready, &start, t, threads]{
+                for (++ready; !start.load();) std::this_thread::yield();
+                insert_slice<n>(t, threads, insert);
+            });
+        }
+        while (ready.load() != threads) std::this_thread::yield();
+        const auto begin = clock::now();
+        start.store(true);
+        for (std::thread& thread: pool) thread.join();
+        const std::chrono::duration<double, std::micro> time
+            = clock::now() - begin;
+        const double rate = n * n * n * n / time.count();
+        best = rate > best ? rate : best;
+        reset();
+    }
+    return best;
+}
+
+// Compares lock-free and globally locked insertion from 1 to 64 threads
+void benchmark_scaling() {
+    constexpr std::size_t n = benchmark_dimension;
+    std::mutex mutex;
+    tensor_type tensor{nullptr};
+    const auto reset = [&tensor]{deallocate<n>(tensor);};
+    std::cout << "[benchmark] " << n * n * n * n << " elements, best of 5\n";
+    std::cout << "[benchmark] threads, lock-free, global lock (Melements/s)\n";
+    for (std::size_t threads = 1; threads <= 64; threads *= 2) {
+        const double lock_free = throughput(threads, [&](type val, auto... i){
+            set_element<n>(val, tensor, i...);
+        }, reset);
+        const double locked = throughput(threads, [&](type val, auto... i){
+            std::lock_guard<std::mutex> lock(mutex);
+            set_element<n>(val, tensor, i...);
+        }, reset);
+        std::cout << threads << ", " << lock_free << ", " << locked << "\n";
+    }
+}
+// ========================================================================== //
+
+
+
+// ================================== MAIN ================================== //
+// Main function
+int main(int argc, char** argv)
+{
+    // Initialization
+    bool success = true;
+
+    // Stress test
+    for (std::size_t writers: {1, 2, 4, 8}) {
+        const bool result = stress(writers, 2);
+        std::cout << "stress " << writers << " writers: ";
+        std::cout << (result ? "ok" : "failed") << "\n";
+        success = success && result;
+    }
+    for (std::size_t writers: {2, 4, 8}) {
+        const bool result = contend(writers, 2);
+        std::cout << "contend " << writers << " writers: ";
+        std::cout << (result ? "ok" : "failed") << "\n";
+        success = success && result;
+    }
+
+    // Benchmark
+    if (argc > 1 && std::string(argv[1]) == "--benchmark") {
+        benchmark_scaling();
+    }
+
+    // Finalization
+    return success ? 0 : 1;
+}
+// ========================================================================== //
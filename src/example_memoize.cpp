@@ -0,0 +1,123 @@
+// ============================= EXAMPLE MEMOIZE ============================ //
+// Project:         Type Utilities
+// Name:            example_memoize.cpp
+// Description:     Use cases for memoize on lambdas, functors and functions
+// Creator:         Vincent Reverdy
+// Contributor(s):  Vincent Reverdy [2018]
+// License:         BSD 3-Clause License
+// ========================================================================== //
+
+
+
+// ================================ PREAMBLE ================================ //
+// C++ standard library
+#include <cmath>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <random>
+#include <iostream>
+// Project sources
+#include "../include/memoize.hpp"
+// Third-party libraries
+// Miscellaneous
+using namespace type_utilities;
+// ========================================================================== //
+
+
+
+// ============================= IMPLEMENTATION ============================= //
+// An expensive pure function
+double cost_model(unsigned int size, double load)
+{
+    double result = 0;
+    for (unsigned int i = 1; i <= 2000; ++i) {
+        result += std::log(1. + load * i) / (size + i);
+    }
+    return result;
+}
+
+// An expensive pure functor
+struct string_score
+{
+    std::size_t operator()(const std::string& name, int salt) const {
+        std::size_t result = salt;
+        for (int i = 0; i < 200; ++i) {
+            for (char c: name) result = result * 31 + c + i;
+        }
+        return result;
+    }
+};
+
+// Displays the counters of a memoized callable
+void display(const char* name, const memoize_statistics& statistics)
+{
+    std::cout << name << ": " << statistics.hits << " hits, ";
+    std::cout << statistics.misses << " misses, hit rate ";
+    std::cout << statistics.hit_rate() << ", evaluation ";
+    std::cout << statistics.evaluation_latency() << " ns\n";
+}
+
+// Measures the average latency of calls over a skewed key distribution
+template <class F>
+double benchmark(F&& f, std::size_t calls, unsigned int seed) {
+    using clock = std::chrono::steady_clock;
+    std::mt19937 engine(seed);
+    std::geometric_distribution<unsigned int> distribution(0.01);
+    double sum = 0;
+    const auto start = clock::now();
+    for (std::size_t i = 0; i < calls; ++i) {
+        sum += f(distribution(engine), 0.5);
+    }
+    const std::chrono::duration<double, std::nano> time = clock::now() - start;
+    return sum != 0 ? time.count() / calls : 0;
+}
+// ========================================================================== //
+
+
+
+// ================================== MAIN ================================== //
+// Main function
+int main(int argc, char** argv)
+{
+    // Initialization
+    auto square = memoize([](int x){return x * x;}, 64);
+    auto score = memoize(string_score(), 256);
+    auto cost = memoize(&cost_model, 4096);
+
+    // Lambdas, functors and function pointers
+    for (int i = 0; i < 100; ++i) square(i % 10);
+    for (int i = 0; i < 100; ++i) score("tensor", i % 3);
+    for (unsigned int i = 0; i < 100; ++i) cost(i % 50, 0.5);
+    display("lambda ", square.statistics());
+    display("functor", score.statistics());
+    display("pointer", cost.statistics());
+
+    // Benchmark
+    if (argc > 1 && std::string(argv[1]) == "--benchmark") {
+        constexpr std::size_t calls = 1000000;
+        const std::size_t threads = std::thread::hardware_concurrency() + 1;
+        auto shared = memoize<true>(&cost_model, 4096);
+        std::vector<std::thread> pool;
+        cost.clear();
+        std::cout << "direct:    " << benchmark(&cost_model, calls / 100, 0);
+        std::cout << " ns/call\n";
+        std::cout << "memoized:  " << benchmark(cost, calls, 0) << " ns/call\n";
+        const auto start = std::chrono::steady_clock::now();
+        for (std::size_t i = 0; i < threads; ++i) {
+            pool.emplace_back([&shared, i]{benchmark(shared, calls, i);});
+        }
+        for (std::thread& thread: pool) thread.join();
+        const std::chrono::duration<double, std::nano> time
+            = std::chrono::steady_clock::now() - start;
+        std::cout << "sharded:   " << time.count() / (calls * threads);
+        std::cout << " ns/call (" << threads << " threads)\n";
+        display("memoized", cost.statistics());
+        display("sharded ", shared.statistics());
+    }
+
+    // Finalization
+    return 0;
+}
+// ========================================================================== //
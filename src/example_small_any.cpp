@@ -0,0 +1,157 @@
+// ============================ EXAMPLE SMALL ANY =========================== //
+// Project:         Type Utilities
+// Name:            example_small_any.cpp
+// Description:     Use cases and latency comparison of small_any and std::any
+// Creator:         Vincent Reverdy
+// Contributor(s):  Vincent Reverdy [2018]
+// License:         BSD 3-Clause License
+// ========================================================================== //
+
+
+
+// ================================ PREAMBLE ================================ //
+// C++ standard library
+#include <any>
+#include <array>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+// Project sources
+#include "../include/small_any.hpp"
+// Third-party libraries
+// Miscellaneous
+using namespace type_utilities;
+// ========================================================================== //
+
+
+
+// ============================= IMPLEMENTATION ============================= //
+// An empty message
+struct heartbeat
+{
+};
+
+// A trivially copyable message
+struct quote
+{
+    unsigned int id;
+    double bid;
+    double ask;
+};
+
+// A message too large to be stored inline
+struct snapshot
+{
+    std::array<double, 16> levels;
+};
+
+// Measures the p50 and p99 latency of a function in nanoseconds per call
+template <class F>
+std::array<double, 2> latency(F&& f) {
+    using clock = std::chrono::steady_clock;
+    constexpr std::size_t samples = 10000;
+    constexpr std::size_t batch = 64;
+    std::vector<double> times(samples);
+    for (std::size_t s = 0; s < samples; ++s) {
+        const auto start = clock::now();
+        for (std::size_t i = 0; i < batch; ++i) f();
+        const std::chrono::duration<double, std::nano> time
+            = clock::now() - start;
+        times[s] = time.count() / batch;
+    }
+    std::sort(times.begin(), times.end());
+    return {times[samples / 2], times[samples * 99 / 100]};
+}
+
+// Forces an object to be materialized in memory and its value to be reloaded
+template <class T>
+void escape(T& object) {
+    asm volatile("" : : "g"(&object) : "memory");
+}
+
+// Compares construction, copy and cast latency for a given value
+template <class Any, class T, class Cast>
+void compare(const char* name, const T& value, Cast&& cast) {
+    const void* volatile sink = nullptr;
+    Any any(value);
+    const auto construction = latency([&]{
+        Any tmp(value);
+        escape(tmp);
+    });
+    const auto copy = latency([&]{
+        Any tmp(any);
+        escape(tmp);
+    });
+    const auto access = latency([&]{
+        escape(any);
+        sink = cast(&any);
+    });
+    std::cout << name << ": construction " << construction[0] << "/";
+    std::cout << construction[1] << " ns, copy " << copy[0] << "/" << copy[1];
+    std::cout << " ns, cast " << access[0] << "/" << access[1] << " ns\n";
+}
+
+// Compares small_any and std::any for a given value
+template <class T>
+void compare(const char* name, const T& value) {
+    using any_t = small_any<>;
+    std::cout << "[" << name << "] p50/p99\n";
+    compare<std::any>("std::any ", value, [](const std::any* x){
+        return std::any_cast<T>(x);
+    });
+    compare<any_t>("small_any", value, [](const any_t* x){
+        return small_any_cast<T>(x);
+    });
+}
+// ========================================================================== //
+
+
+
+// ================================== MAIN ================================== //
+// Main function
+int main(int argc, char** argv)
+{
+    // Initialization
+    using any_t = small_any<>;
+    std::vector<any_t> queue;
+
+    // Heterogeneous message queue
+    queue.emplace_back(heartbeat{});
+    queue.emplace_back(quote{42, 99.5, 100.5});
+    queue.emplace_back(snapshot{});
+    queue.emplace_back(std::string("a message longer than the small buffer"));
+    queue.emplace_back(3.14);
+    for (const any_t& message: queue) {
+        if (const auto* x = small_any_cast<quote>(&message)) {
+            std::cout << "quote " << x->id << ": " << x->bid << "\n";
+        } else if (const auto* x = small_any_cast<std::string>(&message)) {
+            std::cout << "string: " << *x << "\n";
+        } else if (message.holds<heartbeat>()) {
+            std::cout << "heartbeat\n";
+        } else if (message.holds<snapshot>()) {
+            std::cout << "snapshot\n";
+        } else {
+            std::cout << "double: " << small_any_cast<double>(message) << "\n";
+        }
+    }
+
+    // Self-assignment from the contained value
+    any_t message = std::string("a message assigned from itself");
+    message = small_any_cast<std::string&>(message);
+    std::cout << "self-assigned: " << small_any_cast<std::string&>(message);
+    std::cout << "\n";
+
+    // Benchmark
+    if (argc > 1 && std::string(argv[1]) == "--benchmark") {
+        compare("heartbeat", heartbeat{});
+        compare("quote", quote{42, 99.5, 100.5});
+        compare("snapshot", snapshot{});
+        compare("string", std::string("a message longer than the buffer"));
+    }
+
+    // Finalization
+    return 0;
+}
+// ========================================================================== //